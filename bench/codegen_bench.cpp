@@ -0,0 +1,301 @@
+#include <iostream>
+#include <sstream>
+#include <fstream>
+#include <iomanip>
+#include <optional>
+#include <vector>
+#include <string>
+#include <map>
+#include <chrono>
+#include <cstring>
+#include <filesystem>
+#include <algorithm>
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+/*
+    Measures how fast the binaries splongc emits actually run. Every program in the corpus gets compiled
+    with splongc, then its binary is run many times while hardware counters are read through perf_event_open.
+    Where the counters are not available (no PMU, perf_event_paranoid too high) only wall-clock time is reported.
+
+    Usage: splongc_codegen_bench [--runs N] [--corpus DIR] [--baseline FILE] [--save-baseline FILE]
+*/
+
+namespace fs = std::filesystem;
+
+struct Sample {
+    // one program's results, counters are averaged over every run
+    std::map<std::string, double> values;
+};
+
+class CounterGroup {
+    /*
+        Opens the hardware counters on a child that has not exec'd yet. The counters only start
+        when the child calls exec, so the fork and pipe handshake is never counted. They are opened
+        as one group led by cycles, so they are always scheduled onto the PMU together, and if the PMU
+        has to multiplex them the counts are scaled up by how long the group actually ran.
+    */
+public:
+    inline explicit CounterGroup(pid_t pid) {
+        for (auto [name, type, config] : s_counters) {
+            bool leader = m_leader < 0;
+            perf_event_attr attr {};
+            attr.size = sizeof(attr);
+            attr.type = type;
+            attr.config = config;
+            attr.disabled = leader; // the followers start and stop with the leader
+            attr.enable_on_exec = leader;
+            attr.exclude_kernel = 1;
+            attr.exclude_hv = 1;
+            attr.read_format = PERF_FORMAT_GROUP | PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+            int fd = static_cast<int>(syscall(SYS_perf_event_open, &attr, pid, -1, m_leader, 0));
+            if (fd < 0) {
+                if (leader) {
+                    return; // without cycles there is no group at all, only wall-clock time gets reported
+                }
+                continue; // a counter this CPU doesn't have is left out of the group
+            }
+            if (leader) {
+                m_leader = fd;
+            }
+            m_members.push_back({name, fd});
+        }
+    }
+
+    inline CounterGroup(const CounterGroup& other) = delete;
+
+    inline CounterGroup operator=(const CounterGroup& other) = delete;
+
+    inline ~CounterGroup() {
+        for (auto [name, fd] : m_members) {
+            close(fd);
+        }
+    }
+
+    void read_into(Sample& sample) const {
+        if (m_leader < 0) {
+            return;
+        }
+        // group read layout: nr, time_enabled, time_running, then one value per member in opening order
+        std::vector<uint64_t> buf(3 + m_members.size());
+        ssize_t want = static_cast<ssize_t>(buf.size() * sizeof(uint64_t));
+        if (read(m_leader, buf.data(), want) != want || buf[0] != m_members.size() || buf[2] == 0) {
+            return; // the group never got onto the PMU, so there is nothing to scale
+        }
+        double scale = static_cast<double>(buf[1]) / static_cast<double>(buf[2]);
+        for (size_t i = 0; i < m_members.size(); i++) {
+            sample.values[m_members[i].first] += static_cast<double>(buf[3 + i]) * scale;
+        }
+    }
+
+private:
+    struct CounterDesc {
+        const char* name;
+        uint32_t type;
+        uint64_t config;
+    };
+
+    static constexpr CounterDesc s_counters[] = {
+        {"cycles", PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES},
+        {"instructions", PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS},
+        {"branch_misses", PERF_TYPE_HARDWARE, PERF_COUNT_HW_BRANCH_MISSES},
+        {"l1d_misses", PERF_TYPE_HW_CACHE, PERF_COUNT_HW_CACHE_L1D | (PERF_COUNT_HW_CACHE_OP_READ << 8) |
+                                           (PERF_COUNT_HW_CACHE_RESULT_MISS << 16)},
+    };
+
+    int m_leader = -1;
+    std::vector<std::pair<const char*, int>> m_members;
+};
+
+std::optional<int> run_once(const std::string& binary, Sample& sample) {
+    // runs the binary one time, adds its counters and wall time to sample, and returns its exit code
+    int go[2];
+    if (pipe(go) != 0) {
+        return {};
+    }
+    pid_t pid = fork();
+    if (pid == 0) {
+        close(go[1]);
+        char byte;
+        if (read(go[0], &byte, 1) < 0) { // wait until the parent has attached the counters
+            _exit(127);
+        }
+        execl(binary.c_str(), binary.c_str(), static_cast<char*>(nullptr));
+        _exit(127);
+    }
+    close(go[0]);
+    if (pid < 0) {
+        close(go[1]);
+        return {};
+    }
+
+    CounterGroup counters(pid);
+    auto start = std::chrono::steady_clock::now();
+    close(go[1]); // let the child exec
+    int status = 0;
+    waitpid(pid, &status, 0);
+    auto end = std::chrono::steady_clock::now();
+
+    counters.read_into(sample);
+    sample.values["wall_ns"] += static_cast<double>(std::chrono::duration_cast<std::chrono::nanoseconds>(end - start).count());
+    if (!WIFEXITED(status)) {
+        return {};
+    }
+    return WEXITSTATUS(status);
+}
+
+size_t count_instructions(const fs::path& splongc_output) {
+    // static instruction count from the assembly splongc prints, every indented line in the text section is one instruction
+    std::fstream input(splongc_output, std::ios::in);
+    std::string line;
+    bool in_assembly = false;
+    bool in_text = false;
+    size_t count = 0;
+    while (std::getline(input, line)) {
+        if (!in_assembly) {
+            in_assembly = line.starts_with("Assembly code generated:");
+        }
+        else if (line.starts_with("section")) {
+            in_text = line.find(".text") != std::string::npos;
+        }
+        else if (in_text && line.starts_with("    ")) {
+            count++;
+        }
+    }
+    return count;
+}
+
+std::optional<Sample> bench_program(const fs::path& source, int runs) {
+    // every program gets a scratch directory for its binary and what splongc prints
+    fs::path work = fs::temp_directory_path() / ("splongc_bench_" + std::to_string(getpid()) + "_" + source.stem().string());
+    fs::create_directories(work);
+    fs::path binary = work / "out";
+    std::string command = "'" SPLONGC_PATH "' '" + fs::absolute(source).string() + "' -o '" + binary.string() +
+                          "' > '" + (work / "splongc.txt").string() + "'";
+    int status = system(command.c_str());
+    if (status != 0 || !fs::exists(binary)) {
+        std::cerr << source.filename().string() << ": splongc did not produce a binary, DOW\n";
+        fs::remove_all(work);
+        return {};
+    }
+
+    Sample sample;
+    std::optional<int> exit_code;
+    for (int i = 0; i < runs; i++) {
+        exit_code = run_once(binary.string(), sample);
+        if (!exit_code.has_value()) {
+            std::cerr << source.filename().string() << ": binary crashed, DOW\n";
+            fs::remove_all(work);
+            return {};
+        }
+    }
+    for (auto& [name, value] : sample.values) {
+        value /= runs;
+    }
+    sample.values["static_instrs"] = static_cast<double>(count_instructions(work / "splongc.txt"));
+    sample.values["binary_bytes"] = static_cast<double>(fs::file_size(binary));
+    sample.values["exit_code"] = exit_code.value();
+    fs::remove_all(work);
+    return sample;
+}
+
+std::map<std::string, Sample> load_baseline(const std::string& path) {
+    // baseline format: one "program metric value" triple per line
+    std::map<std::string, Sample> baseline;
+    std::fstream input(path, std::ios::in);
+    std::string program, metric;
+    double value;
+    while (input >> program >> metric >> value) {
+        baseline[program].values[metric] = value;
+    }
+    return baseline;
+}
+
+void save_baseline(const std::string& path, const std::map<std::string, Sample>& results) {
+    std::fstream output(path, std::ios::out);
+    for (const auto& [program, sample] : results) {
+        for (const auto& [metric, value] : sample.values) {
+            output << program << " " << metric << " " << std::fixed << std::setprecision(1) << value << "\n";
+        }
+    }
+}
+
+int main(int argc, char* argv[]) {
+    int runs = 200;
+    std::string corpus = SPLONGC_BENCH_CORPUS;
+    std::optional<std::string> baseline_path;
+    std::optional<std::string> save_path;
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        if (arg == "--runs" && i + 1 < argc) {
+            runs = std::max(1, std::stoi(argv[++i]));
+        }
+        else if (arg == "--corpus" && i + 1 < argc) {
+            corpus = argv[++i];
+        }
+        else if (arg == "--baseline" && i + 1 < argc) {
+            baseline_path = argv[++i];
+        }
+        else if (arg == "--save-baseline" && i + 1 < argc) {
+            save_path = argv[++i];
+        }
+        else {
+            std::cerr << "Incorrect usage of splongc_codegen_bench\n";
+            std::cerr << "Options: --runs N, --corpus DIR, --baseline FILE, --save-baseline FILE\n";
+            return EXIT_FAILURE;
+        }
+    }
+
+    std::vector<fs::path> sources;
+    for (const auto& entry : fs::directory_iterator(corpus)) {
+        if (entry.path().extension() == ".splong") {
+            sources.push_back(entry.path());
+        }
+    }
+    std::sort(sources.begin(), sources.end());
+
+    std::map<std::string, Sample> results;
+    bool failed = false;
+    for (const fs::path& source : sources) {
+        if (auto sample = bench_program(source, runs)) {
+            results[source.stem().string()] = sample.value();
+        }
+        else {
+            failed = true;
+        }
+    }
+
+    std::map<std::string, Sample> baseline;
+    if (baseline_path.has_value()) {
+        baseline = load_baseline(baseline_path.value());
+    }
+    bool counters = false;
+    for (const auto& [program, sample] : results) {
+        counters = counters || sample.values.contains("cycles");
+    }
+    if (!counters) {
+        std::cout << "Hardware counters unavailable, reporting wall-clock time only\n";
+    }
+
+    for (const auto& [program, sample] : results) {
+        std::cout << program << "\n";
+        for (const auto& [metric, value] : sample.values) {
+            std::cout << "    " << std::left << std::setw(16) << metric << std::right << std::setw(16)
+                      << std::fixed << std::setprecision(1) << value;
+            if (baseline.contains(program) && baseline.at(program).values.contains(metric)) {
+                double old_value = baseline.at(program).values.at(metric);
+                double change = old_value == 0 ? 0 : (value - old_value) / old_value * 100;
+                std::cout << "    (baseline " << old_value << ", " << std::showpos << change << std::noshowpos << "%)";
+            }
+            std::cout << "\n";
+        }
+    }
+
+    if (save_path.has_value()) {
+        save_baseline(save_path.value(), results);
+    }
+    return failed ? EXIT_FAILURE : EXIT_SUCCESS;
+}
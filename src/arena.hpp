@@ -1,5 +1,10 @@
 #pragma once
 
+#include <cstddef>
+#include <cstdlib>
+#include <new>
+#include <vector>
+
 class ArenaAllocator {
 public:
     inline explicit ArenaAllocator(size_t bytes)
@@ -11,9 +16,15 @@ public:
 
     template<typename T>
     inline T* alloc() {
+        if (m_offset + sizeof(T) > m_buffer + m_size) {
+            // out of room, keep the full block alive and start a fresh one of the same size
+            m_full.push_back(m_buffer);
+            m_buffer = static_cast<std::byte*>(malloc(m_size));
+            m_offset = m_buffer;
+        }
         void* offset = m_offset;
         m_offset += sizeof(T);
-        return static_cast<T*>(offset);
+        return new (offset) T(); // construct in place so members like Token's string start out valid
     }
 
     // copy constructor
@@ -23,6 +34,9 @@ public:
     inline ArenaAllocator operator=(const ArenaAllocator& other) = delete;
 
     inline ~ArenaAllocator() {
+        for (std::byte* block : m_full) {
+            free(block);
+        }
         free(m_buffer);
     }
 
@@ -31,4 +45,5 @@ private:
     size_t m_size;
     std::byte* m_buffer;
     std::byte* m_offset;
+    std::vector<std::byte*> m_full {}; // blocks that filled up before parsing finished
 };
\ No newline at end of file
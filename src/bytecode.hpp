@@ -0,0 +1,372 @@
+#pragma once
+
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <vector>
+#include <variant>
+#include <unordered_map>
+#include <fstream>
+#include <iostream>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include "./value_numbering.hpp"
+
+/*
+    The bytecode for the no-assembler execution mode. Every value is a 64-bit register that holds
+    either an i64 or the bit pattern of an f64, exactly like the native code keeps them on the stack,
+    so exit codes come out the same as the binary nasm and ld would have built.
+*/
+enum class Op : uint8_t {load_i, load_f, mov, add, sub, mul, div, exit, halt};
+
+struct Instr {
+    // register-based, three operand instruction. for load_i and load_f, a is an index into the constant pool
+    Op op;
+    uint8_t unused = 0;
+    uint16_t dst = 0;
+    uint16_t a = 0;
+    uint16_t b = 0;
+};
+static_assert(sizeof(Instr) == 8, "instructions are packed 8 to a cache line of 64 bytes");
+
+union Value {
+    int64_t i;
+    double f;
+};
+static_assert(sizeof(Value) == 8);
+
+struct BytecodeHeader {
+    // the on-disk layout is this header, the constant pool, then the instructions, each 8-byte aligned,
+    // so a mapped file can be executed in place
+    char magic[4] = {'S', 'P', 'L', 'B'};
+    uint32_t version = 1;
+    uint32_t num_consts = 0;
+    uint32_t num_instrs = 0;
+    uint32_t num_regs = 0;
+    uint32_t unused = 0;
+};
+static_assert(sizeof(BytecodeHeader) % 8 == 0);
+
+struct BytecodeView {
+    // a read only look at a program, either owned by a Bytecode or mapped from a file
+    const Value* consts;
+    const Instr* code;
+    uint32_t num_instrs;
+    uint32_t num_regs;
+};
+
+struct Bytecode {
+    std::vector<Value> consts;
+    std::vector<Instr> code;
+    uint32_t num_regs = 0;
+
+    [[nodiscard]] BytecodeView view() const {
+        return {.consts = consts.data(), .code = code.data(), .num_instrs = static_cast<uint32_t>(code.size()), .num_regs = num_regs};
+    }
+
+    void write(const std::string& path) const {
+        BytecodeHeader header;
+        header.num_consts = static_cast<uint32_t>(consts.size());
+        header.num_instrs = static_cast<uint32_t>(code.size());
+        header.num_regs = num_regs;
+        std::fstream output(path, std::ios::out | std::ios::binary);
+        if (!output) {
+            std::cerr << "Could not open " << path << " for writing, DOW\n";
+            exit(EXIT_FAILURE);
+        }
+        output.write(reinterpret_cast<const char*>(&header), sizeof(header));
+        output.write(reinterpret_cast<const char*>(consts.data()), consts.size() * sizeof(Value));
+        output.write(reinterpret_cast<const char*>(code.data()), code.size() * sizeof(Instr));
+        output.close();
+    }
+};
+
+class MappedBytecode {
+    /*
+        Maps a serialized bytecode file straight into memory. Nothing is copied or decoded,
+        the interpreter runs off of the mapped pages.
+    */
+public:
+    inline explicit MappedBytecode(const std::string& path) {
+        int fd = open(path.c_str(), O_RDONLY);
+        struct stat st {};
+        if (fd < 0 || fstat(fd, &st) != 0) {
+            std::cerr << "Could not open bytecode file " << path << ", DOW\n";
+            exit(EXIT_FAILURE);
+        }
+        m_size = static_cast<size_t>(st.st_size);
+        if (m_size < sizeof(BytecodeHeader)) {
+            std::cerr << "Bytecode file " << path << " is truncated, DOW\n";
+            exit(EXIT_FAILURE);
+        }
+        m_data = mmap(nullptr, m_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        close(fd);
+        if (m_data == MAP_FAILED) {
+            std::cerr << "Could not map bytecode file " << path << ", DOW\n";
+            exit(EXIT_FAILURE);
+        }
+
+        const auto* header = static_cast<const BytecodeHeader*>(m_data);
+        if (std::memcmp(header->magic, "SPLB", 4) != 0 || header->version != 1) {
+            std::cerr << path << " is not a splongle bytecode file, DOW\n";
+            exit(EXIT_FAILURE);
+        }
+        size_t payload = m_size - sizeof(BytecodeHeader);
+        if (header->num_consts > payload / sizeof(Value)) { // checked on its own first so the sum below can't wrap
+            std::cerr << "Bytecode file " << path << " is truncated, DOW\n";
+            exit(EXIT_FAILURE);
+        }
+        size_t expected = sizeof(BytecodeHeader) + size_t(header->num_consts) * sizeof(Value) + size_t(header->num_instrs) * sizeof(Instr);
+        if (m_size < expected) {
+            std::cerr << "Bytecode file " << path << " is truncated, DOW\n";
+            exit(EXIT_FAILURE);
+        }
+        const auto* consts = reinterpret_cast<const Value*>(header + 1);
+        m_view = {.consts = consts, .code = reinterpret_cast<const Instr*>(consts + header->num_consts),
+                  .num_instrs = header->num_instrs, .num_regs = header->num_regs};
+        verify(path, header->num_consts);
+    }
+
+    inline MappedBytecode(const MappedBytecode& other) = delete;
+
+    inline MappedBytecode operator=(const MappedBytecode& other) = delete;
+
+    inline ~MappedBytecode() {
+        munmap(m_data, m_size);
+    }
+
+    [[nodiscard]] const BytecodeView& view() const {
+        return m_view;
+    }
+
+private:
+    void verify(const std::string& path, uint32_t num_consts) const {
+        /*
+            The interpreter trusts every operand it is given, so a corrupt or stale file is checked once
+            here instead: every opcode has a handler, every register and constant exists, and the code
+            can't run off the end.
+        */
+        if (m_view.num_regs > UINT16_MAX + 1) { // register operands are 16 bits, so more could never be addressed
+            std::cerr << "Bytecode file " << path << " asks for " << m_view.num_regs << " registers, DOW\n";
+            exit(EXIT_FAILURE);
+        }
+        for (uint32_t i = 0; i < m_view.num_instrs; i++) {
+            const Instr& instr = m_view.code[i];
+            if (static_cast<uint8_t>(instr.op) > static_cast<uint8_t>(Op::halt)) {
+                std::cerr << "Bytecode file " << path << " has an invalid opcode at instruction " << i << ", DOW\n";
+                exit(EXIT_FAILURE);
+            }
+            bool regs_ok = true;
+            switch (instr.op) {
+                case Op::load_i:
+                case Op::load_f:
+                    regs_ok = instr.dst < m_view.num_regs;
+                    if (instr.a >= num_consts) {
+                        std::cerr << "Bytecode file " << path << " loads a missing constant at instruction " << i << ", DOW\n";
+                        exit(EXIT_FAILURE);
+                    }
+                    break;
+                case Op::mov:
+                    regs_ok = instr.dst < m_view.num_regs && instr.a < m_view.num_regs;
+                    break;
+                case Op::add:
+                case Op::sub:
+                case Op::mul:
+                case Op::div:
+                    regs_ok = instr.dst < m_view.num_regs && instr.a < m_view.num_regs && instr.b < m_view.num_regs;
+                    break;
+                case Op::exit:
+                    regs_ok = instr.a < m_view.num_regs;
+                    break;
+                case Op::halt:
+                    break;
+            }
+            if (!regs_ok) {
+                std::cerr << "Bytecode file " << path << " uses a register out of range at instruction " << i << ", DOW\n";
+                exit(EXIT_FAILURE);
+            }
+        }
+        if (m_view.num_instrs == 0 || (m_view.code[m_view.num_instrs - 1].op != Op::exit &&
+                                       m_view.code[m_view.num_instrs - 1].op != Op::halt)) {
+            std::cerr << "Bytecode file " << path << " does not end in exit or halt, DOW\n";
+            exit(EXIT_FAILURE);
+        }
+    }
+
+    void* m_data = nullptr;
+    size_t m_size = 0;
+    BytecodeView m_view {};
+};
+
+class BytecodeGenerator {
+    /*
+        Lowers a NodeProg into bytecode. Each variable and each reused common subexpression owns a register
+        for the whole program, temporaries are handed out above those and recycled after every statement.
+    */
+public:
+    inline explicit BytecodeGenerator(const NodeProg& prog)
+    : m_prog(prog), m_numbering(prog)
+    {}
+
+    uint16_t gen_term(const NodeTerm* term) {
+        struct TermVisitor {
+            BytecodeGenerator* gen;
+            uint16_t operator()(const NodeTermId* term_id) const {
+                auto it = gen->m_vars.find(term_id->id.value.value());
+                if (it == gen->m_vars.end()) {
+                    std::cerr << "Undeclared identifier: " << term_id->id.value.value() << "\n";
+                    exit(EXIT_FAILURE);
+                }
+                return it->second; // variables are read right out of their own register
+            }
+            uint16_t operator()(const NodeTermIntLit* term_int) const {
+                uint16_t dst = gen->temp();
+                gen->emit({.op = Op::load_i, .dst = dst, .a = gen->constant({.i = std::get<int64_t>(term_int->int_lit.literal)})});
+                return dst;
+            }
+            uint16_t operator()(const NodeTermDPLit* term_double) const {
+                uint16_t dst = gen->temp();
+                gen->emit({.op = Op::load_f, .dst = dst, .a = gen->constant({.f = std::get<double>(term_double->dp_lit.literal)})});
+                return dst;
+            }
+            uint16_t operator()(const NodeTermExpr* term_expr) const {
+                return gen->gen_expr(term_expr->expr);
+            }
+        };
+        return std::visit(TermVisitor {.gen = this}, term->var);
+    }
+
+    uint16_t gen_expr(const NodeExpr* expr) {
+        // returns the register that holds the value of the expression
+        if (auto value = m_numbering.reused(expr)) { // already computed into its own register
+            return static_cast<uint16_t>(m_value_base + value.value());
+        }
+        if (std::holds_alternative<NodeTerm*>(expr->var)) {
+            return gen_term(std::get<NodeTerm*>(expr->var));
+        }
+        struct BinVisitor {
+            BytecodeGenerator* gen;
+            uint16_t operator()(const NodeBinExprAdd* add) const { return gen->gen_bin(Op::add, add->left, add->right); }
+            uint16_t operator()(const NodeBinExprSub* sub) const { return gen->gen_bin(Op::sub, sub->left, sub->right); }
+            uint16_t operator()(const NodeBinExprMul* mul) const { return gen->gen_bin(Op::mul, mul->left, mul->right); }
+            uint16_t operator()(const NodeBinExprDiv* div) const {
+                if (std::holds_alternative<NodeTerm*>(div->right->var)) { // division by 0 check, same as the native generator
+                    auto* term = std::get<NodeTerm*>(div->right->var);
+                    if (std::holds_alternative<NodeTermIntLit*>(term->var) &&
+                        std::get<int64_t>(std::get<NodeTermIntLit*>(term->var)->int_lit.literal) == 0) {
+                        std::cerr << "Division by 0 exception, DOW\n";
+                        exit(EXIT_FAILURE);
+                    }
+                }
+                return gen->gen_bin(Op::div, div->left, div->right);
+            }
+        };
+        uint16_t result = std::visit(BinVisitor {.gen = this}, std::get<NodeBinExpr*>(expr->var)->var);
+        if (auto value = m_numbering.producer(expr)) { // keep the value around for the expressions that reuse it
+            uint16_t reg = static_cast<uint16_t>(m_value_base + value.value());
+            emit({.op = Op::mov, .dst = reg, .a = result});
+            return reg;
+        }
+        return result;
+    }
+
+    void gen_stmt(const NodeStmt* stmt) {
+        struct StmtVisitor {
+            BytecodeGenerator* gen;
+            void operator()(const NodeStmtExit* stmt_exit) const {
+                gen->emit({.op = Op::exit, .a = gen->gen_expr(stmt_exit->expr)});
+            }
+            void operator()(const NodeStmtSplinge* stmt_splinge) const {
+                gen->gen_decl(stmt_splinge->id, stmt_splinge->expr);
+            }
+            void operator()(const NodeStmtSplongd* stmt_splongd) const {
+                gen->gen_decl(stmt_splongd->id, stmt_splongd->expr);
+            }
+        };
+        std::visit(StmtVisitor {.gen = this}, stmt->var);
+    }
+
+    [[nodiscard]] Bytecode gen_prog() {
+        // every variable gets its register up front so temporaries can always start right after them
+        for (const NodeStmt* stmt : m_prog.stmts) {
+            if (!std::holds_alternative<NodeStmtExit*>(stmt->var)) {
+                m_num_vars++;
+            }
+        }
+        m_value_base = m_num_vars;
+        m_num_vars += m_numbering.num_values(); // values reused by common subexpressions get registers of their own
+        if (m_num_vars > UINT16_MAX) {
+            std::cerr << "Program needs too many registers for bytecode, DOW\n";
+            exit(EXIT_FAILURE);
+        }
+        for (const NodeStmt* stmt : m_prog.stmts) {
+            m_next_temp = m_num_vars;
+            gen_stmt(stmt);
+        }
+        emit({.op = Op::halt}); // in case there is no explicit exit call, exit without any problems
+        m_bytecode.num_regs = m_max_regs;
+        return std::move(m_bytecode);
+    }
+
+private:
+    uint16_t gen_bin(Op op, const NodeExpr* left, const NodeExpr* right) {
+        size_t mark = m_next_temp;
+        uint16_t a = gen_expr(left);
+        uint16_t b = gen_expr(right);
+        m_next_temp = mark; // operand temporaries are dead once the result is computed
+        uint16_t dst = temp();
+        emit({.op = op, .dst = dst, .a = a, .b = b});
+        return dst;
+    }
+
+    void gen_decl(const Token& id, const NodeExpr* expr) {
+        if (m_vars.contains(id.value.value())) {
+            std::cerr << "Identifier already used: " << id.value.value() << "\n";
+            exit(EXIT_FAILURE);
+        }
+        uint16_t src = gen_expr(expr);
+        uint16_t reg = static_cast<uint16_t>(m_vars.size());
+        emit({.op = Op::mov, .dst = reg, .a = src});
+        m_vars.insert({id.value.value(), reg});
+    }
+
+    uint16_t temp() {
+        if (m_next_temp > UINT16_MAX) {
+            std::cerr << "Program needs too many registers for bytecode, DOW\n";
+            exit(EXIT_FAILURE);
+        }
+        m_max_regs = std::max(m_max_regs, static_cast<uint32_t>(m_next_temp + 1));
+        return static_cast<uint16_t>(m_next_temp++);
+    }
+
+    uint16_t constant(Value value) {
+        // identical bit patterns share one slot in the constant pool
+        int64_t bits;
+        std::memcpy(&bits, &value, sizeof(bits));
+        auto [it, inserted] = m_const_index.insert({bits, m_bytecode.consts.size()});
+        if (inserted) {
+            m_bytecode.consts.push_back(value);
+        }
+        if (it->second > UINT16_MAX) {
+            std::cerr << "Too many constants for bytecode, DOW\n";
+            exit(EXIT_FAILURE);
+        }
+        return static_cast<uint16_t>(it->second);
+    }
+
+    void emit(Instr instr) {
+        m_bytecode.code.push_back(instr);
+    }
+
+    const NodeProg& m_prog;
+    const ValueNumbering m_numbering;
+    Bytecode m_bytecode;
+    std::unordered_map<std::string, uint16_t> m_vars {};
+    std::unordered_map<int64_t, size_t> m_const_index {};
+    size_t m_num_vars = 0;
+    size_t m_value_base = 0; // first register holding a reused value
+    size_t m_next_temp = 0;
+    uint32_t m_max_regs = 0;
+};
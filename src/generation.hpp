@@ -3,11 +3,16 @@
 #include <unordered_map>
 #include <cassert>
 #include <variant>
+#include <array>
+#include <algorithm>
+#include <bit>
+#include <cstdint>
+#include "./value_numbering.hpp"
 class Generator {
 
 public:
     inline Generator(NodeProg prog)
-    : m_prog(std::move(prog))
+    : m_prog(std::move(prog)), m_numbering(m_prog)
     {}
 
     void gen_term(const NodeTerm* term) {
@@ -18,23 +23,22 @@ public:
                     std::cerr << "Undeclared identifier: " << term_id->id.value.value() << "\n";
                     exit(EXIT_FAILURE);
                 }
-                std::stringstream offset;
                 const auto& var = gen->m_symbol_table.at(term_id->id.value.value());
-                offset << "QWORD [rsp + " << (gen->m_stack_size - var.stack_loc - 1) * 8 << "]";
-                gen->push(offset.str());
+                gen->push(var.loc); // push straight from the variable's register or frame slot
             }
             void operator()(const NodeTermIntLit* term_int) const {
-                gen->m_output << "    mov rax, " << term_int->int_lit.value.value() << "\n";
-                gen->push("rax");
+                int64_t value = std::get<int64_t>(term_int->int_lit.literal);
+                if (fits_imm32(value)) {
+                    gen->push(std::to_string(value)); // push sign extends a 32-bit immediate to 64 bits
+                }
+                else {
+                    gen->m_output << "    mov rax, " << value << "\n";
+                    gen->push("rax");
+                }
             }
             void operator()(const NodeTermDPLit* term_double) const {
-                std::string label = "L" + std::to_string(gen->m_label_counter++); // make a label of L + the current label counter and then post increment it
-                gen->m_data << label << ": dq " << term_double->dp_lit.value.value() << "\n";
-
-                gen->m_output << "    movsd xmm0, [rel " << label << "]\n";
-                gen->m_output << "    sub rsp, 8\n"; // this makes space on the stack for a double
-                gen->m_output << "    movsd [rsp], xmm0\n"; // this moves the double into wherever the stack pointer is
-                gen->m_stack_size++; // explicitly state to increase stack size because we didn't call push()
+                // doubles are pushed straight out of the constant pool as their 64-bit pattern
+                gen->push("QWORD [rel " + gen->pool_label(std::get<double>(term_double->dp_lit.literal)) + "]");
             }
             void operator()(const NodeTermExpr* term_expr) const {
                 gen->gen_expr(term_expr->expr); // call gen_expr using the term expression's expression, don't need to generate anything here
@@ -45,6 +49,10 @@ public:
     }
 
     void gen_expr(const NodeExpr* expr) {
+        if (auto value = m_numbering.reused(expr)) { // this exact value was already computed, just load it
+            push(m_value_slots.at(value.value()));
+            return;
+        }
         struct ExprVisitor {
             Generator* gen;
 
@@ -54,52 +62,40 @@ public:
             void operator()(const NodeBinExpr* bin_expr) const {
                 if (std::holds_alternative<NodeBinExprMul*>(bin_expr->var)) { // this is asking are we doing a multiplication
                     auto* mul_expr = std::get<NodeBinExprMul*>(bin_expr->var); // get the whole expression
-                    gen->gen_expr(mul_expr->left); // generate the left operand
-                    gen->gen_expr(mul_expr->right); // generate the right operand
-                    gen->pop("rcx"); // put the right operand into rcx
-                    gen->pop("rax"); // put the left operand into rax
-                    gen->m_output << "    imul rax, rcx\n"; // this means rax = rax * rcx
+                    std::string right = gen->gen_operands(mul_expr->left, mul_expr->right); // left operand in rax, right operand wherever it lives
+                    gen->m_output << "    imul rax, " << right << "\n"; // this means rax = rax * right
                     gen->push("rax"); // push the new result
                 }
                 else if (std::holds_alternative<NodeBinExprDiv*>(bin_expr->var)) { // this is asking are we doing a division
                     auto* div_expr = std::get<NodeBinExprDiv*>(bin_expr->var); // get the whole expression
-                    gen->gen_expr(div_expr->left); // gen numerator
 
                     if (auto* right_expr = div_expr->right; // division by 0 check
                         std::holds_alternative<NodeTerm*>(right_expr->var)) {
                         auto* term = std::get<NodeTerm*>(right_expr->var);
                         if (std::holds_alternative<NodeTermIntLit*>(term->var)) {
                             auto* lit = std::get<NodeTermIntLit*>(term->var);
-                            if (lit->int_lit.value == "0") {
+                            if (std::get<int64_t>(lit->int_lit.literal) == 0) {
                                 std::cerr << "Division by 0 exception, DOW\n";
                                 exit(EXIT_FAILURE);
                             }
                         }
                     }
 
-                    gen->gen_expr(div_expr->right); // gen denominator
-                    gen->pop("rcx"); // rcx = denominator
-                    gen->pop("rax"); // rax = numerator
+                    std::string right = gen->gen_operands(div_expr->left, div_expr->right, false); // rax = numerator, right = denominator, idiv has no immediate form
                     gen->m_output << "    cqo\n"; // this sign extends rax into rdx, result is a 128-bit integer rdx:rax
-                    gen->m_output << "    idiv rcx\n"; // rax = rax / rcx, rdx = rax % rcx
+                    gen->m_output << "    idiv " << right << "\n"; // rax = rax / right, rdx = rax % right
                     gen->push("rax"); // push the new result
                 }
                 else if (std::holds_alternative<NodeBinExprAdd*>(bin_expr->var)) { // this is asking are we doing an addition
                     auto* add_expr = std::get<NodeBinExprAdd*>(bin_expr->var); // get the whole expression
-                    gen->gen_expr(add_expr->left); // generate the left operand
-                    gen->gen_expr(add_expr->right); // generate the right operand
-                    gen->pop("rcx"); // put the right operand into rcx
-                    gen->pop("rax"); // put the left operand into rax
-                    gen->m_output << "    add rax, rcx\n"; // this means rax = rax + rcx
+                    std::string right = gen->gen_operands(add_expr->left, add_expr->right); // left operand in rax, right operand wherever it lives
+                    gen->m_output << "    add rax, " << right << "\n"; // this means rax = rax + right
                     gen->push("rax"); // push the new result
                 }
                 else if (std::holds_alternative<NodeBinExprSub*>(bin_expr->var)) { // this is asking are we doing a subtraction
                     auto* sub_expr = std::get<NodeBinExprSub*>(bin_expr->var); // get the whole expression
-                    gen->gen_expr(sub_expr->left); // generate the left operand
-                    gen->gen_expr(sub_expr->right); // generate the right operand
-                    gen->pop("rcx"); // put the right operand into rcx
-                    gen->pop("rax"); // put the left operand into rax
-                    gen->m_output << "    sub rax, rcx\n"; // this means rax = rax - rcx
+                    std::string right = gen->gen_operands(sub_expr->left, sub_expr->right); // left operand in rax, right operand wherever it lives
+                    gen->m_output << "    sub rax, " << right << "\n"; // this means rax = rax - right
                     gen->push("rax"); // push the new result
                 }
                 else {
@@ -110,6 +106,10 @@ public:
 
         ExprVisitor visitor {.gen = this};
         std::visit(visitor, expr->var);
+        if (auto value = m_numbering.producer(expr)) { // later expressions reuse this value, so save a copy
+            m_output << "    mov rax, QWORD [rsp]\n";
+            m_output << "    mov " << m_value_slots.at(value.value()) << ", rax\n";
+        }
     }
 
     void gen_stmt(const NodeStmt* stmt) {
@@ -127,8 +127,10 @@ public:
                     std::cerr << "Identifier already used: " << stmt_splinge->id.value.value() << "\n";
                     exit(EXIT_FAILURE);
                 }
-                gen->m_symbol_table.insert({stmt_splinge->id.value.value(), Var {.stack_loc = gen->m_stack_size, .type = VarType::Int}});                
                 gen->gen_expr(stmt_splinge->expr);
+                const std::string& loc = gen->m_layout.at(stmt_splinge->id.value.value());
+                gen->pop(loc); // store the value into its register or frame slot
+                gen->m_symbol_table.insert({stmt_splinge->id.value.value(), Var {.loc = loc, .type = VarType::Int}});
             }
 
             void operator()(const NodeStmtSplongd* stmt_splongd) {
@@ -136,8 +138,10 @@ public:
                     std::cerr << "Identifier already used: " << stmt_splongd->id.value.value() << "\n";
                     exit(EXIT_FAILURE);
                 }
-                gen->m_symbol_table.insert({stmt_splongd->id.value.value(), Var {.stack_loc = gen->m_stack_size, .type = VarType::Double}});                
                 gen->gen_expr(stmt_splongd->expr);
+                const std::string& loc = gen->m_layout.at(stmt_splongd->id.value.value());
+                gen->pop(loc); // doubles always live in frame slots
+                gen->m_symbol_table.insert({stmt_splongd->id.value.value(), Var {.loc = loc, .type = VarType::Double}});
             }
         };
         StmtVisitor visitor {.gen = this};
@@ -145,6 +149,14 @@ public:
     }
 
     [[nodiscard]] std::string gen_prog() {
+        size_t frame_slots = layout_frame();
+        if (frame_slots > 0) {
+            // fixed frame: every variable slot is addressed off of rbp, so pushes and pops
+            // of temporaries never move a variable's address
+            m_output << "    push rbp\n";
+            m_output << "    mov rbp, rsp\n";
+            m_output << "    sub rsp, " << frame_slots * 8 << "\n";
+        }
         for (const NodeStmt* stmt: m_prog.stmts) {
             gen_stmt(stmt);
         }
@@ -153,36 +165,197 @@ public:
         m_output << "    mov rdi, 0\n"; 
         m_output << "    syscall\n";
 
-        // the following prepends the data section for doubles to what was generated above
-        std::string output = "section .data\n" + m_data.str();
-        output += "\nsection .text\n";
+        // the following prepends the constant pool for doubles to what was generated above
+        std::string output;
+        if (!m_const_pool.empty()) {
+            output += "section .rodata\n";
+            output += "align 16\n";
+            output += m_data.str();
+            output += "\n";
+        }
+        output += "section .text\n";
         output += "global _start\n_start:\n";
         output += m_output.str();
         return output;
     }
 
+    // number of expression nodes common subexpression elimination kept from being generated
+    [[nodiscard]] size_t cse_eliminated() const {
+        return m_numbering.eliminated();
+    }
+
 private:
+    // callee-saved registers that splinge variables can be promoted into. _start never returns,
+    // so there is no caller whose copies of these need saving
+    static constexpr std::array<const char*, 5> s_promote_regs {"rbx", "r12", "r13", "r14", "r15"};
+
+    void count_uses(const NodeExpr* expr) {
+        // walks an expression and counts how many times each identifier is read
+        if (m_numbering.reused(expr).has_value()) {
+            return; // reused values never read their variables again
+        }
+        if (std::holds_alternative<NodeTerm*>(expr->var)) {
+            auto* term = std::get<NodeTerm*>(expr->var);
+            if (std::holds_alternative<NodeTermId*>(term->var)) {
+                m_use_counts[std::get<NodeTermId*>(term->var)->id.value.value()]++;
+            }
+            else if (std::holds_alternative<NodeTermExpr*>(term->var)) {
+                count_uses(std::get<NodeTermExpr*>(term->var)->expr);
+            }
+            return;
+        }
+        std::visit([this](const auto* bin) { count_uses(bin->left); count_uses(bin->right); },
+                   std::get<NodeBinExpr*>(expr->var)->var);
+    }
+
+    size_t layout_frame() {
+        /*
+            Decides where every variable lives before any code is generated. The most read splinge
+            variables get promoted into callee-saved registers, everything else gets a fixed slot
+            below rbp. Returns the number of frame slots, rounded up to an odd count: rsp is 16-byte aligned
+            at _start and 8 off after push rbp, so an odd number of 8-byte slots brings it back into alignment.
+        */
+        std::vector<std::string> splinges;
+        std::vector<std::string> frame_vars;
+        for (const NodeStmt* stmt : m_prog.stmts) {
+            if (std::holds_alternative<NodeStmtExit*>(stmt->var)) {
+                count_uses(std::get<NodeStmtExit*>(stmt->var)->expr);
+            }
+            else if (std::holds_alternative<NodeStmtSplinge*>(stmt->var)) {
+                auto* splinge = std::get<NodeStmtSplinge*>(stmt->var);
+                count_uses(splinge->expr);
+                splinges.push_back(splinge->id.value.value());
+            }
+            else {
+                auto* splongd = std::get<NodeStmtSplongd*>(stmt->var);
+                count_uses(splongd->expr);
+                frame_vars.push_back(splongd->id.value.value());
+            }
+        }
+
+        // stable sort so ties go to whichever variable was declared first
+        std::stable_sort(splinges.begin(), splinges.end(), [this](const std::string& a, const std::string& b) {
+            return m_use_counts[a] > m_use_counts[b];
+        });
+        size_t next_reg = 0;
+        for (const std::string& name : splinges) {
+            if (m_layout.contains(name)) { // redeclarations get reported during generation
+                continue;
+            }
+            if (next_reg < s_promote_regs.size() && m_use_counts[name] > 0) {
+                m_layout.insert({name, s_promote_regs[next_reg++]});
+            }
+            else {
+                frame_vars.push_back(name);
+            }
+        }
+
+        size_t slots = 0;
+        for (const std::string& name : frame_vars) {
+            if (m_layout.contains(name)) {
+                continue;
+            }
+            m_layout.insert({name, "QWORD [rbp - " + std::to_string(++slots * 8) + "]"});
+        }
+        for (size_t i = 0; i < m_numbering.num_values(); i++) { // slots for values reused by common subexpressions
+            m_value_slots.push_back("QWORD [rbp - " + std::to_string(++slots * 8) + "]");
+        }
+        return slots == 0 ? 0 : slots | 1;
+    }
+
+    static bool fits_imm32(int64_t value) {
+        return value >= INT32_MIN && value <= INT32_MAX;
+    }
+
+    std::string pool_label(double value) {
+        // constants are pooled by bit pattern, so every repeat of a value shares one label
+        auto bits = std::bit_cast<uint64_t>(value);
+        auto [it, inserted] = m_const_pool.insert({bits, "L" + std::to_string(m_const_pool.size())});
+        if (inserted) {
+            m_data << it->second << ": dq 0x" << std::hex << bits << std::dec << "\n"; // the exact bits, no decimal round trip
+        }
+        return it->second;
+    }
+
+    std::optional<std::string> direct_operand(const NodeExpr* expr, bool allow_imm) const {
+        // an already declared splinge, a reused value, or a small enough integer literal can be
+        // used as an instruction operand right where it lives
+        expr = ValueNumbering::unwrap(expr);
+        if (auto value = m_numbering.reused(expr)) {
+            return m_value_slots.at(value.value());
+        }
+        if (!std::holds_alternative<NodeTerm*>(expr->var)) {
+            return {};
+        }
+        auto* term = std::get<NodeTerm*>(expr->var);
+        if (allow_imm && std::holds_alternative<NodeTermIntLit*>(term->var)) {
+            int64_t value = std::get<int64_t>(std::get<NodeTermIntLit*>(term->var)->int_lit.literal);
+            if (fits_imm32(value)) {
+                return std::to_string(value);
+            }
+        }
+        if (!std::holds_alternative<NodeTermId*>(term->var)) {
+            return {};
+        }
+        auto it = m_symbol_table.find(std::get<NodeTermId*>(term->var)->id.value.value());
+        if (it == m_symbol_table.end() || it->second.type != VarType::Int) {
+            return {}; // let gen_term report undeclared identifiers
+        }
+        return it->second.loc;
+    }
+
+    std::string gen_operands(const NodeExpr* left, const NodeExpr* right, bool right_imm = true) {
+        /*
+            Puts the left operand of a binary expression into rax and returns the operand
+            to use for the right side. Variables and small literals are used in place instead of going through the stack.
+        */
+        std::optional<std::string> left_op = direct_operand(left, true);
+        std::optional<std::string> right_op = direct_operand(right, right_imm);
+        if (right_op.has_value()) {
+            if (left_op.has_value()) {
+                m_output << "    mov rax, " << left_op.value() << "\n";
+            }
+            else {
+                gen_expr(left);
+                pop("rax");
+            }
+            return right_op.value();
+        }
+        if (left_op.has_value()) {
+            gen_expr(right);
+            pop("rcx");
+            m_output << "    mov rax, " << left_op.value() << "\n";
+            return "rcx";
+        }
+        gen_expr(left); // generate the left operand
+        gen_expr(right); // generate the right operand
+        pop("rcx"); // put the right operand into rcx
+        pop("rax"); // put the left operand into rax
+        return "rcx";
+    }
+
     void push(const std::string& reg) {
         m_output << "    push " << reg << "\n";
-        m_stack_size++;
     }
 
     void pop(const std::string& reg) {
         m_output << "    pop " << reg << "\n";
-        m_stack_size--;
     }
 
     enum class VarType {Int, Double};
 
     struct Var {
-        size_t stack_loc;
+        std::string loc; // register or rbp-relative frame slot holding the variable
         VarType type;
     };
 
     const NodeProg m_prog;
+    const ValueNumbering m_numbering;
+    std::vector<std::string> m_value_slots {}; // frame slot for each value the value numbering saves
     std::stringstream m_output;
     std::stringstream m_data; // this is for double constants
-    size_t m_label_counter = 0; // this is for double constants
-    size_t m_stack_size = 0;
+    std::unordered_map<uint64_t, std::string> m_const_pool {}; // bit pattern of a double constant -> its label
     std::unordered_map<std::string, Var> m_symbol_table {};
+    std::unordered_map<std::string, std::string> m_layout {}; // where each variable lives, decided before generation
+    std::unordered_map<std::string, size_t> m_use_counts {}; // how many times each variable is read
 };
\ No newline at end of file
@@ -0,0 +1,72 @@
+#pragma once
+
+#include <csignal>
+#include <cstdint>
+#include <vector>
+#include "./bytecode.hpp"
+
+class Interpreter {
+    /*
+        Runs bytecode without nasm or ld. Dispatch is threaded through computed gotos, so every
+        handler jumps straight to the next one instead of going back through a switch.
+    */
+public:
+    inline explicit Interpreter(const BytecodeView& code)
+    : m_code(code), m_regs(code.num_regs)
+    {}
+
+    // returns the value given to exit(), the process exit code is its low byte just like the native binary
+    [[nodiscard]] int64_t run() {
+        static void* const dispatch[] = {
+            &&do_load_i, &&do_load_f, &&do_mov, &&do_add, &&do_sub, &&do_mul, &&do_div, &&do_exit, &&do_halt
+        };
+        static_assert(sizeof(dispatch) / sizeof(dispatch[0]) == static_cast<size_t>(Op::halt) + 1);
+
+        const Instr* ip = m_code.code;
+        const Value* consts = m_code.consts;
+        Value* regs = m_regs.data();
+
+        if (m_code.num_instrs == 0) {
+            return 0;
+        }
+
+#define DISPATCH() goto *dispatch[static_cast<uint8_t>(ip->op)]
+#define NEXT() do { ++ip; DISPATCH(); } while (0)
+
+        DISPATCH();
+
+    do_load_i:
+    do_load_f: // both are the same 64 bits, the type only matters to whoever reads them
+        regs[ip->dst] = consts[ip->a];
+        NEXT();
+    do_mov:
+        regs[ip->dst] = regs[ip->a];
+        NEXT();
+    do_add: // wrap around on overflow like the hardware does
+        regs[ip->dst].i = static_cast<int64_t>(static_cast<uint64_t>(regs[ip->a].i) + static_cast<uint64_t>(regs[ip->b].i));
+        NEXT();
+    do_sub:
+        regs[ip->dst].i = static_cast<int64_t>(static_cast<uint64_t>(regs[ip->a].i) - static_cast<uint64_t>(regs[ip->b].i));
+        NEXT();
+    do_mul:
+        regs[ip->dst].i = static_cast<int64_t>(static_cast<uint64_t>(regs[ip->a].i) * static_cast<uint64_t>(regs[ip->b].i));
+        NEXT();
+    do_div:
+        if (regs[ip->b].i == 0 || (regs[ip->a].i == INT64_MIN && regs[ip->b].i == -1)) {
+            std::raise(SIGFPE); // idiv faults on these, so the native binary dies the same way
+        }
+        regs[ip->dst].i = regs[ip->a].i / regs[ip->b].i;
+        NEXT();
+    do_exit:
+        return regs[ip->a].i;
+    do_halt:
+        return 0;
+
+#undef NEXT
+#undef DISPATCH
+    }
+
+private:
+    const BytecodeView m_code;
+    std::vector<Value> m_regs;
+};
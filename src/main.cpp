@@ -8,51 +8,74 @@
 #include "./tokenization.hpp"
 #include "./parser.hpp"
 #include "./generation.hpp"
+#include "./bytecode.hpp"
+#include "./interpreter.hpp"
+#include "./toolchain.hpp"
 
 
 
 int main(int argc, char* argv[]) {
-    if (argc != 2) { // handling incorrect usage of the splongle compiler
+    // splongc <source> [-o <binary>] compiles to a native binary, called out unless -o says otherwise
+    // modes that skip nasm and ld entirely:
+    //   splongc --interpret <source>             run the program in the bytecode interpreter
+    //   splongc --emit-bytecode <source> <out>   serialize the program's bytecode to out
+    //   splongc --run-bytecode <file>            run a serialized bytecode file
+    std::string mode = argc > 1 ? argv[1] : "";
+    if (mode == "--run-bytecode" && argc == 3) {
+        MappedBytecode bytecode(argv[2]);
+        Interpreter interpreter(bytecode.view());
+        return static_cast<int>(interpreter.run() & 0xff); // the kernel only keeps the low byte of an exit code
+    }
+    bool interpret = mode == "--interpret" && argc == 3;
+    bool emit_bytecode = mode == "--emit-bytecode" && argc == 4;
+    bool native = !mode.starts_with("--") && (argc == 2 || (argc == 4 && std::string(argv[2]) == "-o"));
+    if (!native && !interpret && !emit_bytecode) { // handling incorrect usage of the splongle compiler
 
         std::cerr << "Incorrect usage of splongc\n";
-        std::cerr << "Call splongc, then provide a splongle source file\n";
+        std::cerr << "Call splongc, then provide a splongle source file, optionally followed by -o <binary>\n";
+        std::cerr << "Or use --interpret <source>, --emit-bytecode <source> <out>, or --run-bytecode <file>\n";
         return EXIT_FAILURE;
 
     }
+    const char* source_path = native ? argv[1] : argv[2];
 
-    std::fstream input(argv[1], std::ios::in); // treat the input file (cl argument 2) as ONLY input
+    std::fstream input(source_path, std::ios::in); // treat the input file as ONLY input
     std::stringstream contents_stream;
     contents_stream << input.rdbuf(); // read the entire input file as a string stream
     std::string contents = contents_stream.str(); // convert that string stream into a string
     input.close();
 
-    std::cout << "File contents: \n" << contents << "\n";
+    if (!interpret && !emit_bytecode) {
+        std::cout << "File contents: \n" << contents << "\n";
+    }
 
     Tokenizer tokenizer(std::move(contents)); // std::move improves performance i guess by not making copies
 
-    std::vector<Token> tokens = tokenizer.tokenize();
-
-    Parser parser(std::move(tokens));
+    Parser parser(std::move(tokenizer)); // the parser pulls tokens out of the tokenizer as it needs them
     std::optional<NodeProg> prog = parser.parse_program();
     if (!prog.has_value()) {
         std::cerr << "Invalid program, DOW\n";
         return EXIT_FAILURE;
     }
 
+    if (interpret || emit_bytecode) {
+        BytecodeGenerator bytecode_generator(prog.value());
+        Bytecode bytecode = bytecode_generator.gen_prog();
+        if (emit_bytecode) {
+            bytecode.write(argv[3]);
+            return EXIT_SUCCESS;
+        }
+        Interpreter interpreter(bytecode.view());
+        return static_cast<int>(interpreter.run() & 0xff); // the kernel only keeps the low byte of an exit code
+    }
+
     Generator generator(prog.value());
+    std::string assembly = generator.gen_prog();
+
+    Toolchain toolchain; // nasm and ld work out of memory files, only the binary is written to disk
+    bool built = toolchain.build(assembly, argc == 4 ? argv[3] : "out");
 
-    
-    std::fstream output("out.asm", std::ios::out); // treat the output assembly file as ONLY output
-    output << generator.gen_prog(); // write assembly to the output
-    output.close();
-
-    system("nasm -felf64 out.asm");
-    system("ld -o out out.o");
-    std::stringstream assembly_stream;
-    std::fstream ass_file("out.asm", std::ios::in);
-    assembly_stream << ass_file.rdbuf();
-    std::string assembly = assembly_stream.str();
-    ass_file.close();
     std::cout << "Assembly code generated:\n" << assembly << "\n";
-    return EXIT_SUCCESS;
+    std::cout << "Common subexpression elimination removed " << generator.cse_eliminated() << " expression nodes\n";
+    return built ? EXIT_SUCCESS : EXIT_FAILURE;
 }
\ No newline at end of file
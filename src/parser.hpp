@@ -3,6 +3,8 @@
 #include "tokenization.hpp"
 #include <variant>
 #include <optional>
+#include <array>
+#include <cassert>
 #include "./arena.hpp"
 
 struct NodeTermIntLit {
@@ -100,8 +102,8 @@ struct NodeProg{
 class Parser {
 
 public:
-    inline explicit Parser(std::vector<Token> tokens) 
-    : m_tokens(std::move(tokens)), m_allocator(1024 * 1024 * 4) // arena is 4MB
+    inline explicit Parser(Tokenizer tokenizer) 
+    : m_tokenizer(std::move(tokenizer)), m_allocator(1024 * 1024 * 4) // arena is 4MB
     {}
 
     // function to define operator precedence
@@ -318,20 +320,36 @@ public:
 
 private:
 
-    const std::vector<Token> m_tokens;
-    size_t m_index = 0;
-
-    [[nodiscard]] inline std::optional<Token> peek(int offset = 0) const { // [[nodiscard]] = ignore stupid compiler complaints about a function literally doing nothing
-        if (m_index + offset >= m_tokens.size()) {
-            return {};
-        }
-        else {
-            return m_tokens.at(m_index + offset);
+    // the parser never looks more than 3 tokens ahead, so only that many are ever held at once.
+    // tokens are pulled from the tokenizer into this ring buffer as peek() asks for them
+    static constexpr size_t s_lookahead = 4; // power of 2 so wrapping around is just a mask
+
+    Tokenizer m_tokenizer;
+    std::array<Token, s_lookahead> m_ring {};
+    size_t m_head = 0; // ring index of the next token to consume
+    size_t m_count = 0; // how many tokens are buffered
+
+    [[nodiscard]] inline std::optional<Token> peek(int offset = 0) { // [[nodiscard]] = ignore stupid compiler complaints about a function literally doing nothing
+        assert(static_cast<size_t>(offset) < s_lookahead);
+        while (m_count <= static_cast<size_t>(offset)) {
+            std::optional<Token> token = m_tokenizer.next();
+            if (!token.has_value()) {
+                return {};
+            }
+            m_ring[(m_head + m_count++) & (s_lookahead - 1)] = std::move(token.value());
         }
+        return m_ring[(m_head + offset) & (s_lookahead - 1)];
     }
 
     inline Token consume() {
-        return m_tokens.at(m_index++);
+        if (m_count == 0 && !peek().has_value()) {
+            std::cerr << "Unexpected end of input, DOW\n";
+            exit(EXIT_FAILURE);
+        }
+        Token token = std::move(m_ring[m_head]);
+        m_head = (m_head + 1) & (s_lookahead - 1);
+        m_count--;
+        return token;
     }
 
     ArenaAllocator m_allocator;
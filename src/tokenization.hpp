@@ -4,6 +4,10 @@
 #include <vector>
 #include <iostream>
 #include <algorithm>
+#include <optional>
+#include <variant>
+#include <charconv>
+#include <cstdint>
 
 /*
     The different tokens of splongle
@@ -18,6 +22,7 @@ struct Token {
     */
     TokenType type;
     std::optional<std::string> value {}; // default nothing
+    std::variant<std::monostate, int64_t, double> literal {}; // decoded value of an int_lit or dp_lit
     
 };
 
@@ -29,12 +34,12 @@ public:
         m_src(std::move(src)), m_index(0)
     {}
 
-    inline std::vector<Token> tokenize() {
+    inline std::optional<Token> next() {
         /* 
-            This function is responsible for tokenizing the input file.
-            Usage: str = input file as a string
+            This function is responsible for tokenizing the input file. Each call makes just the next token,
+            so the parser pulls tokens as it goes instead of the whole file being tokenized up front.
+            Returns nothing once the end of the input is reached.
         */
-        std::vector<Token> tokens; // used for storing all tokens, return value
         std::string buf; // used for storing current token
         while (peek().has_value()) {
             if (std::isalpha(peek().value())) {
@@ -43,29 +48,19 @@ public:
                     buf.push_back(consume());
                 }
                 if (buf == "exit") { // handle exit keyword
-                    tokens.push_back({.type = TokenType::exit});
-                    buf.clear();
-                    continue;
+                    return Token {.type = TokenType::exit};
                 }
                 else if (buf == "splong") { // handle splong end of statement
-                    tokens.push_back({.type = TokenType::splong});
-                    buf.clear();
-                    continue;
+                    return Token {.type = TokenType::splong};
                 }
                 else if (buf == "splinge") { // splinge data type
-                    tokens.push_back({.type = TokenType::splinge});
-                    buf.clear();
-                    continue;
+                    return Token {.type = TokenType::splinge};
                 }
                 else if (buf == "splongd") {
-                    tokens.push_back({.type = TokenType::splongd});
-                    buf.clear();
-                    continue;
+                    return Token {.type = TokenType::splongd};
                 }
                 else { // make a variable 
-                    tokens.push_back({.type = TokenType::id, .value = buf});
-                    buf.clear();
-                    continue;
+                    return Token {.type = TokenType::id, .value = buf};
                 }
             }
             // TODO: I need to check what the data type declared for the variable is, otherwise I think this could put doubles in integer identifiers
@@ -93,9 +88,7 @@ public:
                     exit(EXIT_FAILURE);
                 }
                 else { // if it passes all of the checks, tokenize it
-                    tokens.push_back({.type = TokenType::dp_lit, .value = buf});
-                    buf.clear();
-                    continue;
+                    return Token {.type = TokenType::dp_lit, .literal = parse_double(buf)};
                 }
             } 
             else if (std::isdigit(peek().value())) { // handle integer literals (64-bits)
@@ -122,15 +115,11 @@ public:
                         exit(EXIT_FAILURE);
                     }
                     else { // if it passes all of the checks, tokenize it
-                        tokens.push_back({.type = TokenType::dp_lit, .value = buf});
-                        buf.clear();
-                        continue;
+                        return Token {.type = TokenType::dp_lit, .literal = parse_double(buf)};
                     }
                 }
                 else { // otherwise we can say it's an integer
-                tokens.push_back({.type = TokenType::int_lit, .value = buf});
-                buf.clear();
-                continue;
+                return Token {.type = TokenType::int_lit, .literal = parse_int(buf)};
                 }
             }
             else if (std::isspace(peek().value())) { // ignore any white space characters
@@ -139,49 +128,70 @@ public:
             }
             else if (peek().value() == '(') { // handle openeing parenthesis
                 consume();
-                tokens.push_back({.type = TokenType::open_paren});
-                continue;
+                return Token {.type = TokenType::open_paren};
             }
             else if (peek().value() == ')') { // handle closing parenthesis
                 consume();
-                tokens.push_back({.type = TokenType::close_paren});
-                continue;
+                return Token {.type = TokenType::close_paren};
             }
             else if (peek().value() == '=') { // handle assignment
                 consume();
-                tokens.push_back({.type = TokenType::assign});
-                continue;
+                return Token {.type = TokenType::assign};
             }
             else if (peek().value() == '*') { // handle multiplication
                 consume();
-                tokens.push_back({.type = TokenType::mul});
-                continue;
+                return Token {.type = TokenType::mul};
             }
             else if (peek().value() == '/') { // handle division
                 consume();
-                tokens.push_back({.type = TokenType::div});
-                continue;
+                return Token {.type = TokenType::div};
             }
             else if (peek().value() == '+') { // handle addition
                 consume();
-                tokens.push_back({.type = TokenType::add});
-                continue;
+                return Token {.type = TokenType::add};
             }
             else if (peek().value() == '-') { // handle subtraction
                 consume();
-                tokens.push_back({.type = TokenType::sub});
-                continue;
+                return Token {.type = TokenType::sub};
             }
             else { // handle any undefined tokens of splongle
                 std::cerr << "Unidentified token, DOW\n";
                 exit(EXIT_FAILURE);
             }
         }
-        m_index = 0;
-        return tokens;
+        return {};
     }
 
 private:
+
+    static int64_t parse_int(const std::string& buf) {
+        // literals are decoded once here, everything after the tokenizer works with the number itself
+        int64_t value = 0;
+        auto [end, err] = std::from_chars(buf.data(), buf.data() + buf.size(), value);
+        if (err == std::errc::result_out_of_range) {
+            std::cerr << "Integer literal " << buf << " does not fit in 64 bits, DOW\n";
+            exit(EXIT_FAILURE);
+        }
+        if (err != std::errc() || end != buf.data() + buf.size()) {
+            std::cerr << "Invalid integer literal: " << buf << ", DOW\n";
+            exit(EXIT_FAILURE);
+        }
+        return value;
+    }
+
+    static double parse_double(const std::string& buf) {
+        double value = 0;
+        auto [end, err] = std::from_chars(buf.data(), buf.data() + buf.size(), value);
+        if (err == std::errc::result_out_of_range) {
+            std::cerr << "Floating-point literal " << buf << " is out of range for a double, DOW\n";
+            exit(EXIT_FAILURE);
+        }
+        if (err != std::errc() || end != buf.data() + buf.size()) {
+            std::cerr << "Invalid floating-point literal: " << buf << ", DOW\n";
+            exit(EXIT_FAILURE);
+        }
+        return value;
+    }
     
     [[nodiscard]] inline std::optional<char> peek(int offset = 0) const { // [[nodiscard]] = ignore stupid compiler complaints about a function literally doing nothing
         if (m_index + offset >= m_src.length()) {
@@ -196,7 +206,7 @@ private:
         return m_src.at(m_index++);
     }
 
-    const std::string m_src;
+    std::string m_src; // not const so the tokenizer can be moved into the parser without copying the source
     size_t m_index;
 
 };
\ No newline at end of file
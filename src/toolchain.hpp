@@ -0,0 +1,101 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <iostream>
+#include <cerrno>
+#include <cstring>
+#include <spawn.h>
+#include <sys/mman.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+extern char** environ;
+
+class Toolchain {
+    /*
+        Runs nasm and ld on generated assembly. The assembly and the object file live in anonymous
+        memory files (memfd) instead of out.asm and out.o in the working directory, so nothing touches
+        the disk except the final binary and concurrent invocations can't clobber each other.
+        nasm re-reads its input on every pass, so it can't assemble from a pipe; it gets the memfd
+        through /proc instead, which can be reopened and rewound like a normal file.
+    */
+public:
+    inline Toolchain()
+    : m_asm_fd(memfd_create("splongc.asm", MFD_CLOEXEC)), m_obj_fd(memfd_create("splongc.o", MFD_CLOEXEC))
+    {}
+
+    inline Toolchain(const Toolchain& other) = delete;
+
+    inline Toolchain operator=(const Toolchain& other) = delete;
+
+    inline ~Toolchain() {
+        if (m_asm_fd >= 0) {
+            close(m_asm_fd);
+        }
+        if (m_obj_fd >= 0) {
+            close(m_obj_fd);
+        }
+    }
+
+    // assembles and links the assembly into an executable at binary_path, returns false if any step failed
+    [[nodiscard]] bool build(const std::string& assembly, const std::string& binary_path) {
+        if (m_asm_fd < 0 || m_obj_fd < 0) {
+            std::cerr << "Could not create memory files for nasm and ld: " << std::strerror(errno) << ", DOW\n";
+            return false;
+        }
+        size_t written = 0;
+        while (written < assembly.size()) {
+            ssize_t n = write(m_asm_fd, assembly.data() + written, assembly.size() - written);
+            if (n < 0 && errno != EINTR) {
+                std::cerr << "Could not write assembly: " << std::strerror(errno) << ", DOW\n";
+                return false;
+            }
+            written += n > 0 ? static_cast<size_t>(n) : 0;
+        }
+
+        std::string asm_path = fd_path(m_asm_fd);
+        std::string obj_path = fd_path(m_obj_fd);
+        if (run({"nasm", "-felf64", "-o", obj_path, asm_path}) != 0) {
+            std::cerr << "nasm failed, DOW\n";
+            return false;
+        }
+        if (run({"ld", "-o", binary_path, obj_path}) != 0) { // link as soon as the object is ready
+            std::cerr << "ld failed, DOW\n";
+            return false;
+        }
+        return true;
+    }
+
+private:
+    static std::string fd_path(int fd) {
+        // the tools are separate processes, so they need our pid in the path rather than /proc/self
+        return "/proc/" + std::to_string(getpid()) + "/fd/" + std::to_string(fd);
+    }
+
+    static int run(const std::vector<std::string>& args) {
+        // spawns a tool found through PATH and waits for it, returns its exit status or -1 if it never ran properly
+        std::vector<char*> argv;
+        for (const std::string& arg : args) {
+            argv.push_back(const_cast<char*>(arg.c_str()));
+        }
+        argv.push_back(nullptr);
+
+        pid_t pid;
+        int err = posix_spawnp(&pid, argv[0], nullptr, nullptr, argv.data(), environ);
+        if (err != 0) {
+            std::cerr << "Could not run " << args[0] << ": " << std::strerror(err) << "\n";
+            return -1;
+        }
+        int status = 0;
+        while (waitpid(pid, &status, 0) < 0) {
+            if (errno != EINTR) {
+                return -1;
+            }
+        }
+        return WIFEXITED(status) ? WEXITSTATUS(status) : -1;
+    }
+
+    int m_asm_fd;
+    int m_obj_fd;
+};
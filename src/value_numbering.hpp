@@ -0,0 +1,160 @@
+#pragma once
+
+#include <unordered_map>
+#include <unordered_set>
+#include <string>
+#include <variant>
+#include <vector>
+#include <optional>
+#include <bit>
+#include "./parser.hpp"
+
+class ValueNumbering {
+    /*
+        Global value numbering over every expression in the program. Structurally identical expressions
+        get the same number, with + and * operands put in a fixed order so a + b and b + a match too.
+        Variables are never reassigned and there is no control flow, so once an expression has been
+        computed its value holds for the rest of the program: the first occurrence saves its result
+        and every later occurrence reuses it instead of being generated again.
+    */
+public:
+    inline explicit ValueNumbering(const NodeProg& prog) {
+        for (const NodeStmt* stmt : prog.stmts) {
+            std::visit([this](const auto* s) { visit(s->expr); }, stmt->var);
+        }
+        for (const NodeExpr* producer : m_first_order) { // program order keeps the slot numbering stable
+            if (m_reused_vns.contains(m_vn.at(producer))) {
+                m_producers.insert({producer, m_num_values++});
+            }
+        }
+        for (auto& [expr, vn] : m_reused) {
+            vn = m_producers.at(m_first.at(vn)); // reused expressions point at the value slot of their producer
+        }
+    }
+
+    // index of the saved value this expression should read instead of being generated, if any
+    [[nodiscard]] std::optional<size_t> reused(const NodeExpr* expr) const {
+        auto it = m_reused.find(expr);
+        return it == m_reused.end() ? std::nullopt : std::optional<size_t>(it->second);
+    }
+
+    // index of the value slot this expression should save its result into, if anything reuses it
+    [[nodiscard]] std::optional<size_t> producer(const NodeExpr* expr) const {
+        auto it = m_producers.find(expr);
+        return it == m_producers.end() ? std::nullopt : std::optional<size_t>(it->second);
+    }
+
+    [[nodiscard]] size_t num_values() const {
+        return m_num_values;
+    }
+
+    // how many expression nodes never get generated because their value was reused
+    [[nodiscard]] size_t eliminated() const {
+        return m_eliminated;
+    }
+
+    static const NodeExpr* unwrap(const NodeExpr* expr) {
+        // parentheses don't change the value, so they are looked straight through
+        while (std::holds_alternative<NodeTerm*>(expr->var) &&
+               std::holds_alternative<NodeTermExpr*>(std::get<NodeTerm*>(expr->var)->var)) {
+            expr = std::get<NodeTermExpr*>(std::get<NodeTerm*>(expr->var)->var)->expr;
+        }
+        return expr;
+    }
+
+private:
+    struct Key {
+        int op;
+        size_t left;
+        size_t right;
+        bool operator==(const Key& other) const = default;
+    };
+
+    struct KeyHash {
+        size_t operator()(const Key& key) const {
+            size_t hash = std::hash<size_t>{}(key.left);
+            hash ^= std::hash<size_t>{}(key.right) + 0x9e3779b97f4a7c15 + (hash << 6) + (hash >> 2);
+            return hash ^ static_cast<size_t>(key.op);
+        }
+    };
+
+    size_t number(const NodeExpr* expr) {
+        // bottom up, hash-conses the expression and returns its value number
+        expr = unwrap(expr);
+        if (auto it = m_vn.find(expr); it != m_vn.end()) {
+            return it->second;
+        }
+        size_t vn;
+        if (std::holds_alternative<NodeTerm*>(expr->var)) {
+            auto* term = std::get<NodeTerm*>(expr->var);
+            std::string leaf;
+            if (std::holds_alternative<NodeTermIntLit*>(term->var)) {
+                leaf = "i" + std::to_string(std::get<int64_t>(std::get<NodeTermIntLit*>(term->var)->int_lit.literal));
+            }
+            else if (std::holds_alternative<NodeTermDPLit*>(term->var)) {
+                leaf = "d" + std::to_string(std::bit_cast<uint64_t>(std::get<double>(std::get<NodeTermDPLit*>(term->var)->dp_lit.literal)));
+            }
+            else {
+                leaf = "v" + std::get<NodeTermId*>(term->var)->id.value.value();
+            }
+            vn = m_leaves.insert({leaf, m_next_vn}).first->second;
+        }
+        else {
+            auto* bin = std::get<NodeBinExpr*>(expr->var);
+            Key key = std::visit([this, bin](const auto* op) {
+                return Key {.op = static_cast<int>(bin->var.index()), .left = number(op->left), .right = number(op->right)};
+            }, bin->var);
+            bool commutative = std::holds_alternative<NodeBinExprAdd*>(bin->var) ||
+                               std::holds_alternative<NodeBinExprMul*>(bin->var);
+            if (commutative && key.left > key.right) {
+                std::swap(key.left, key.right);
+            }
+            vn = m_exprs.insert({key, m_next_vn}).first->second;
+        }
+        if (vn == m_next_vn) {
+            m_next_vn++;
+        }
+        m_vn.insert({expr, vn});
+        return vn;
+    }
+
+    size_t count_nodes(const NodeExpr* expr) const {
+        expr = unwrap(expr);
+        if (std::holds_alternative<NodeTerm*>(expr->var)) {
+            return 1;
+        }
+        return 1 + std::visit([this](const auto* op) { return count_nodes(op->left) + count_nodes(op->right); },
+                              std::get<NodeBinExpr*>(expr->var)->var);
+    }
+
+    void visit(const NodeExpr* expr) {
+        // top down in program order, so the first occurrence of a value is always generated before its reuses
+        expr = unwrap(expr);
+        if (std::holds_alternative<NodeTerm*>(expr->var)) {
+            return; // literals and variables are already as cheap as reading a saved value
+        }
+        size_t vn = number(expr);
+        if (m_first.contains(vn)) {
+            m_reused.insert({expr, vn});
+            m_reused_vns.insert(vn);
+            m_eliminated += count_nodes(expr);
+            return; // nothing below a reused expression gets generated
+        }
+        m_first.insert({vn, expr});
+        m_first_order.push_back(expr);
+        std::visit([this](const auto* op) { visit(op->left); visit(op->right); },
+                   std::get<NodeBinExpr*>(expr->var)->var);
+    }
+
+    std::unordered_map<const NodeExpr*, size_t> m_vn {};
+    std::unordered_map<std::string, size_t> m_leaves {};
+    std::unordered_map<Key, size_t, KeyHash> m_exprs {};
+    std::unordered_map<size_t, const NodeExpr*> m_first {}; // value number -> first expression computing it
+    std::vector<const NodeExpr*> m_first_order {};
+    std::unordered_set<size_t> m_reused_vns {};
+    std::unordered_map<const NodeExpr*, size_t> m_reused {};
+    std::unordered_map<const NodeExpr*, size_t> m_producers {};
+    size_t m_next_vn = 0;
+    size_t m_num_values = 0;
+    size_t m_eliminated = 0;
+};